@@ -0,0 +1,98 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Mass/MassDrawOcclusion.h"
+#include "Engine/World.h"
+#include "MassSlateDraw.h"
+#include "Mass/MassDrawTraitBase.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("MassDraw - Occlusion Traces Requested"), STAT_MassDrawOcclusionTracesRequested, STATGROUP_MassDraw);
+
+void MassSlateDraw::Occlusion::RequestTrace(UWorld& World, const FVector& ViewOrigin, const FVector& TargetPosition, const ECollisionChannel TraceChannel, FMassDrawOcclusionFragment& Occlusion)
+{
+	static const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(MassDrawOcclusion), false);
+	Occlusion.PendingTrace = World.AsyncLineTraceByChannel(EAsyncTraceType::Test, ViewOrigin, TargetPosition, TraceChannel, QueryParams);
+	INC_DWORD_STAT(STAT_MassDrawOcclusionTracesRequested);
+}
+
+bool MassSlateDraw::Occlusion::ConsumeTraceResult(UWorld& World, FMassDrawOcclusionFragment& Occlusion)
+{
+	if (!Occlusion.PendingTrace.IsValid())
+	{
+		return true;
+	}
+
+	FTraceDatum TraceData;
+	if (World.QueryTraceData(Occlusion.PendingTrace, TraceData))
+	{
+		//Test traces only report whether anything blocked the segment.
+		Occlusion.bIsOccluded = TraceData.OutHits.Num() > 0;
+		Occlusion.PendingTrace = FTraceHandle();
+		return true;
+	}
+
+	if (!World.IsTraceHandleValid(Occlusion.PendingTrace, false))
+	{
+		Occlusion.PendingTrace = FTraceHandle();
+		return true;
+	}
+
+	return false;
+}
+
+bool MassSlateDraw::Occlusion::ApplyOcclusion(const FMassDrawOcclusionParameters& Parameters, const FMassDrawOcclusionFragment& Occlusion, FMassDrawStateFragment& DrawState)
+{
+	if (!Occlusion.bIsOccluded || Parameters.Mode == EMassDrawOcclusionMode::None)
+	{
+		return true;
+	}
+
+	if (Parameters.Mode == EMassDrawOcclusionMode::Hide || Parameters.OccludedOpacity <= 0.f)
+	{
+		DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
+		return false;
+	}
+
+	DrawState.Opacity = Parameters.OccludedOpacity;
+	return true;
+}
+
+void MassSlateDraw::Occlusion::FTraceScheduler::BeginFrame(const int32 TraceBudget)
+{
+	TracesRemaining = FMath::Max(TraceBudget, 0);
+	BudgetReservedAfterCursor = FMath::Max(LastVisibleCount - Cursor, 0);
+	VisitIndex = 0;
+	LastTraceIndex = INDEX_NONE;
+	LastWrappedTraceIndex = INDEX_NONE;
+}
+
+bool MassSlateDraw::Occlusion::FTraceScheduler::VisitEntity(const bool bCanRequestTrace)
+{
+	const int32 Index = VisitIndex++;
+	const bool bIsAfterCursor = Index >= Cursor;
+	const int32 AvailableBudget = bIsAfterCursor ? TracesRemaining : TracesRemaining - BudgetReservedAfterCursor;
+
+	if (!bCanRequestTrace || AvailableBudget <= 0)
+	{
+		return false;
+	}
+
+	TracesRemaining--;
+	if (bIsAfterCursor)
+	{
+		LastTraceIndex = Index;
+	}
+	else
+	{
+		LastWrappedTraceIndex = Index;
+	}
+	return true;
+}
+
+void MassSlateDraw::Occlusion::FTraceScheduler::EndFrame()
+{
+	//If the budget ran out, resume after the last traced entity. Traces wrapped around to the start of the list were issued last.
+	//Otherwise every visible entity got a chance, start over.
+	const int32 LastTracedIndex = LastWrappedTraceIndex != INDEX_NONE ? LastWrappedTraceIndex : LastTraceIndex;
+	Cursor = TracesRemaining == 0 && LastTracedIndex != INDEX_NONE && VisitIndex > 0 ? (LastTracedIndex + 1) % VisitIndex : 0;
+	LastVisibleCount = VisitIndex;
+}
@@ -5,6 +5,8 @@
 #include "Engine/LocalPlayer.h"
 #include "MassCommonFragments.h"
 #include "Mass/MassDrawTraitBase.h"
+#include "Mass/MassDrawOcclusion.h"
+#include "Mass/MassDrawSubsystem.h"
 #include "MassExecutionContext.h"
 #include "MassSlateDraw.h"
 #include "Blueprint/WidgetLayoutLibrary.h"
@@ -24,6 +26,14 @@ namespace MassSlateDraw::ProjectionProcessor
 		"(instead of letting only Slate handle it)."),
 		ECVF_Default);
 
+	//Async occlusion traces are time sliced. Entities that don't fit in this frame's budget keep their cached result.
+	static int32 OcclusionTraceBudget = 256;
+	static FAutoConsoleVariableRef CVarOcclusionTraceBudget(
+		TEXT("MassSlateDraw.ProjectionProcessor.OcclusionTraceBudget"),
+		OcclusionTraceBudget,
+		TEXT("Maximum number of occlusion line traces the mass draw projection processor will request per frame."),
+		ECVF_Default);
+
 };
 
 UMassDrawProjectionProcessor::UMassDrawProjectionProcessor(const FObjectInitializer& ObjectInitializer)
@@ -32,6 +42,10 @@ UMassDrawProjectionProcessor::UMassDrawProjectionProcessor(const FObjectInitiali
 	ProcessingPhase = EMassProcessingPhase::FrameEnd; //Icon screen position processing needs to run after camera updates to be accurate to the current frame.
 	
 	ExecutionFlags = (int32)(EProcessorExecutionFlags::Client | EProcessorExecutionFlags::Standalone);
+	bRequiresGameThreadExecution = true; //Reads the local player's view and UMassDrawSubsystem's caches, which are owned by the game thread.
+
+	//Bound once instead of per ForEachEntityChunk call.
+	ProjectChunkFunction = [this](FMassExecutionContext& LocalContext) { ProjectChunk(LocalContext); };
 }
 
 void UMassDrawProjectionProcessor::ConfigureQueries()
@@ -39,6 +53,9 @@ void UMassDrawProjectionProcessor::ConfigureQueries()
 	DrawProjectionQuery.RegisterWithProcessor(*this);
 	DrawProjectionQuery.AddRequirement<FMassDrawStateFragment>(EMassFragmentAccess::ReadWrite);
 	DrawProjectionQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	DrawProjectionQuery.AddRequirement<FMassDrawTargetProjectionFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	DrawProjectionQuery.AddRequirement<FMassDrawOcclusionFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::Optional);
+	DrawProjectionQuery.AddConstSharedRequirement<FMassDrawOcclusionParameters>(EMassFragmentPresence::Optional);
 }
 
 inline FIntRect::IntPointType ToIntPoint(const FVector2f& VectorPoint)
@@ -71,108 +88,210 @@ FORCEINLINE bool ProjectWorldToScreen(const FVector& WorldPosition, const FVecto
 	return true;
 }
 
+//Orthographic top-down projection onto a secondary target. Returns false if the icon's extent falls entirely outside the target's rectangle.
+FORCEINLINE bool ProjectWorldToTarget(const FVector& WorldPosition, const FMassDrawProjectionTarget& Target, const FVector2f& TargetCenter, const FVector2f& IconHalfSize, FVector2f& OutTargetPosition)
+{
+	const FVector2f WorldDelta = FVector2f(WorldPosition.X - Target.WorldCenter.X, WorldPosition.Y - Target.WorldCenter.Y) * Target.WorldToViewScale;
+	OutTargetPosition = FVector2f(TargetCenter.X + WorldDelta.Y, TargetCenter.Y - WorldDelta.X);
+
+	return OutTargetPosition.X + IconHalfSize.X >= Target.ViewRect.X && OutTargetPosition.X - IconHalfSize.X <= Target.ViewRect.Z
+		&& OutTargetPosition.Y + IconHalfSize.Y >= Target.ViewRect.Y && OutTargetPosition.Y - IconHalfSize.Y <= Target.ViewRect.W;
+}
+
 DECLARE_CYCLE_STAT(TEXT("MassDraw - ProjectionProcessor"), STAT_MassDrawProjectionProcessor, STATGROUP_MassDraw);
 void UMassDrawProjectionProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
 {
 	SCOPE_CYCLE_COUNTER(STAT_MassDrawProjectionProcessor);
+	LLM_SCOPE_BYTAG(MassDraw);
 	
-	const UWorld* World = EntityManager.GetWorld();
+	UWorld* World = EntityManager.GetWorld();
 	
 	if(!World)
 	{
 		return;
 	}
 	
+	//Secondary targets are copied so the chunk pass only touches the targets that are actually registered.
+	//They are gathered before resolving the main view so that minimaps keep updating while it is unavailable.
+	FrameData.ProjectionTargets.Reset();
+	FrameData.TargetCenters.Reset();
+	UMassDrawSubsystem* DrawSubsystem = World->GetSubsystem<UMassDrawSubsystem>();
+	if (DrawSubsystem)
+	{
+		for (int32 TargetIndex = 0; TargetIndex < MassSlateDraw::MaxProjectionTargets; TargetIndex++)
+		{
+			if (DrawSubsystem->IsProjectionTargetRegistered(TargetIndex))
+			{
+				FrameData.ProjectionTargets.Emplace(TargetIndex, DrawSubsystem->GetProjectionTarget(TargetIndex));
+				FrameData.TargetCenters.Add(DrawSubsystem->GetProjectionTarget(TargetIndex).GetViewRectCenter());
+			}
+		}
+	}
+
 	const APlayerController* LocalPlayerController = World->GetFirstPlayerController();
+	const ULocalPlayer* const LocalPlayer = LocalPlayerController ? LocalPlayerController->GetLocalPlayer() : nullptr;
+	
+	FSceneViewProjectionData ProjectionData;
+	FrameData.bMainViewValid = false;
+	if (LocalPlayer && LocalPlayer->ViewportClient)
+	{
+		LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData);
+		FrameData.bMainViewValid = ProjectionData.IsValidViewRectangle();
+	}
 
-	if(!LocalPlayerController)
+	if (!FrameData.bMainViewValid && FrameData.ProjectionTargets.Num() == 0)
 	{
 		return;
 	}
 
-	const ULocalPlayer* const LocalPlayer = LocalPlayerController->GetLocalPlayer();
+	FrameData.World = World;
+	//Uses the same cached scale the draw layers paint with so culling matches what ends up on screen.
+	const float ViewportScale = DrawSubsystem ? DrawSubsystem->GetViewportScale(LocalPlayer)
+		: (LocalPlayer && LocalPlayer->ViewportClient ? UWidgetLayoutLibrary::GetViewportScale(LocalPlayer->ViewportClient) : 0.f);
+	FrameData.ViewportScale = ViewportScale > 0.f ? ViewportScale : 1.f;
+	FrameData.bPerformPreculling = MassSlateDraw::ProjectionProcessor::bPerformPreculling;
 
-	if(!LocalPlayer || !LocalPlayer->ViewportClient)
+	if (FrameData.bMainViewValid)
 	{
-		return;
+		FrameData.ViewRect = ProjectionData.GetConstrainedViewRect();
+		FrameData.ViewRectFloat = FVector4f(FrameData.ViewRect.Min.X, FrameData.ViewRect.Min.Y, FrameData.ViewRect.Max.X, FrameData.ViewRect.Max.Y);
+		FrameData.ViewProjectionMatrix = ProjectionData.ComputeViewProjectionMatrix();
+		FrameData.ViewOrigin = ProjectionData.ViewOrigin;
 	}
-	
-	FSceneViewProjectionData ProjectionData;
-	LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData);
 
-	if (!ProjectionData.IsValidViewRectangle())
+	OcclusionTraceScheduler.BeginFrame(MassSlateDraw::ProjectionProcessor::OcclusionTraceBudget);
+
+	const int32 NumCachedArchetypes = DrawProjectionQuery.GetArchetypes().Num();
+	DrawProjectionQuery.ForEachEntityChunk(EntityManager, Context, ProjectChunkFunction);
+	if (DrawProjectionQuery.GetArchetypes().Num() != NumCachedArchetypes)
+	{
+		INC_DWORD_STAT(STAT_MassDrawCacheGrowths);
+	}
+
+	//Nothing was visited without a main view, keep the cursor where it was.
+	if (FrameData.bMainViewValid)
+	{
+		OcclusionTraceScheduler.EndFrame();
+	}
+}
+
+void UMassDrawProjectionProcessor::ProjectChunk(FMassExecutionContext& LocalContext)
+{
+	const TArrayView<FMassDrawStateFragment> DrawStateList = LocalContext.GetMutableFragmentView<FMassDrawStateFragment>();
+	const TConstArrayView<FTransformFragment> TransformList = LocalContext.GetFragmentView<FTransformFragment>();
+	const TArrayView<FMassDrawTargetProjectionFragment> TargetProjectionList = LocalContext.GetMutableFragmentView<FMassDrawTargetProjectionFragment>();
+	//Nothing is written to the target fragments unless at least one target is registered. Layers ignore the stale masks of unregistered targets.
+	const bool bProjectToTargets = TargetProjectionList.Num() > 0 && FrameData.ProjectionTargets.Num() > 0;
+
+	if (!FrameData.bMainViewValid && !bProjectToTargets)
 	{
 		return;
 	}
+	const TArrayView<FMassDrawOcclusionFragment> OcclusionList = LocalContext.GetMutableFragmentView<FMassDrawOcclusionFragment>();
+	const FMassDrawOcclusionParameters* OcclusionParameters = LocalContext.GetConstSharedFragmentPtr<FMassDrawOcclusionParameters>();
+	const bool bTestOcclusion = OcclusionList.Num() > 0 && OcclusionParameters && OcclusionParameters->Mode != EMassDrawOcclusionMode::None;
 	
-	const bool bPerformPreculling = MassSlateDraw::ProjectionProcessor::bPerformPreculling;
-	const float ViewportScale = UWidgetLayoutLibrary::GetViewportScale(LocalPlayer->ViewportClient);
-	
-	DrawProjectionQuery.ForEachEntityChunk(EntityManager, Context, [ProjectionData, bPerformPreculling, ViewportScale](FMassExecutionContext& LocalContext)
+	const int32 NumEntities = LocalContext.GetNumEntities();
+	FVector3f EntityScreenPosition = FVector3f(-UE_MAX_FLT);
+
+	for(int32 Index = NumEntities - 1; Index >= 0; Index--)
 	{
-		const TArrayView<FMassDrawStateFragment> DrawStateList = LocalContext.GetMutableFragmentView<FMassDrawStateFragment>();
-		const TConstArrayView<FTransformFragment> TransformList = LocalContext.GetFragmentView<FTransformFragment>();
+		FMassDrawStateFragment& DrawState = DrawStateList[Index];
+		FMassDrawTargetProjectionFragment* TargetProjection = bProjectToTargets ? &TargetProjectionList[Index] : nullptr;
+
+		if (TargetProjection)
+		{
+			TargetProjection->VisibleTargetMask = 0;
+		}
+
+		if (!DrawState.bIsEnabled)
+		{
+			DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
+			continue;
+		}
+		
+		const FVector TransformedPosition = TransformList[Index].GetTransform().TransformPosition(DrawState.WorldOffset);
+
+		//Secondary targets reuse the transform already loaded for the main view and are culled independently of it.
+		if (TargetProjection)
+		{
+			for (int32 TargetListIndex = 0; TargetListIndex < FrameData.ProjectionTargets.Num(); TargetListIndex++)
+			{
+				const int32 TargetIndex = FrameData.ProjectionTargets[TargetListIndex].Key;
+				const FMassDrawProjectionTarget& Target = FrameData.ProjectionTargets[TargetListIndex].Value;
+				const FVector2f TargetIconHalfSize = DrawState.ExtentHalfSize * (FrameData.ViewportScale * Target.IconScale);
+
+				if (ProjectWorldToTarget(TransformedPosition, Target, FrameData.TargetCenters[TargetListIndex], TargetIconHalfSize, TargetProjection->TargetPositions[TargetIndex]))
+				{
+					TargetProjection->VisibleTargetMask |= static_cast<uint8>(1 << TargetIndex);
+				}
+			}
+		}
+
+		//Without a main view, icons keep their last screen position like they did before secondary targets existed.
+		if (!FrameData.bMainViewValid)
+		{
+			continue;
+		}
 		
-		const int32 NumEntities = LocalContext.GetNumEntities();
+		if(!ProjectWorldToScreen(TransformedPosition, FrameData.ViewRectFloat, FrameData.ViewProjectionMatrix, EntityScreenPosition))
+		{
+			DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
+			continue;
+		}
 
-		const FIntRect& ViewRectangle = ProjectionData.GetConstrainedViewRect();
-		const FVector4f ViewRectangleFloat(ViewRectangle.Min.X, ViewRectangle.Min.Y, ViewRectangle.Max.X, ViewRectangle.Max.Y);
-		FMatrix const ViewProjectionMatrix = ProjectionData.ComputeViewProjectionMatrix();
-		FVector3f EntityScreenPosition = FVector3f(-UE_MAX_FLT);
+		const float DrawScale = DrawState.DistanceScale != -1.f ? FrameData.ViewportScale * (1.f - ((EntityScreenPosition.Z - DrawState.DistanceScale) / DrawState.DistanceScale)) : FrameData.ViewportScale;
 
-		for(int32 Index = NumEntities - 1; Index >= 0; Index--)
+		if (DrawScale <= 0.f)
+		{
+			DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
+			continue;
+		}
+		
+		if(FrameData.bPerformPreculling)
 		{
-			FMassDrawStateFragment& DrawState = DrawStateList[Index];
+			const FVector2f TotalIconHalfSize = DrawState.ExtentHalfSize * DrawScale;
 
-			if (!DrawState.bIsEnabled)
+			if (TotalIconHalfSize.X < 0.5f || TotalIconHalfSize.Y < 0.5f)
 			{
 				DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
 				continue;
 			}
 			
-			const FVector TransformedPosition = TransformList[Index].GetTransform().TransformPosition(DrawState.WorldOffset);
-			
-			if(!ProjectWorldToScreen(TransformedPosition, ViewRectangleFloat, ViewProjectionMatrix, EntityScreenPosition))
+		#if WITH_EDITOR
+			//Editor has an issue where the given rectangle is not 100% accurate.
+			const FVector2f UsedIconHalfSize = (DrawState.ExtentHalfSize * DrawScale) + (GEditor ? FVector2f(16.f, 32.f) : FVector2f(0.f));
+		#else
+			const FVector2f UsedIconHalfSize = TotalIconHalfSize;
+		#endif
+						
+			const FIntRect::IntPointType DrawItemTopLeft = FIntRect::IntPointType(ToIntPoint(FVector2f(EntityScreenPosition) - UsedIconHalfSize));
+			const FIntRect::IntPointType DrawItemBottomRight = FIntRect::IntPointType(ToIntPoint(FVector2f(EntityScreenPosition) + UsedIconHalfSize));
+			if(!FrameData.ViewRect.Intersect(FIntRect(DrawItemTopLeft, DrawItemBottomRight)))
 			{
 				DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
 				continue;
 			}
+		}
 
-			const float DrawScale = DrawState.DistanceScale != -1.f ? ViewportScale * (1.f - ((EntityScreenPosition.Z - DrawState.DistanceScale) / DrawState.DistanceScale)) : ViewportScale;
+		DrawState.Opacity = 1.f;
+
+		if (bTestOcclusion)
+		{
+			FMassDrawOcclusionFragment& Occlusion = OcclusionList[Index];
+			const bool bCanRequestTrace = MassSlateDraw::Occlusion::ConsumeTraceResult(*FrameData.World, Occlusion);
 
-			if (DrawScale <= 0.f)
+			if (OcclusionTraceScheduler.VisitEntity(bCanRequestTrace))
 			{
-				DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
-				continue;
+				MassSlateDraw::Occlusion::RequestTrace(*FrameData.World, FrameData.ViewOrigin, TransformedPosition, OcclusionParameters->TraceChannel, Occlusion);
 			}
-			
-			if(bPerformPreculling)
-			{
-				const FVector2f TotalIconHalfSize = DrawState.ExtentHalfSize * DrawScale;
 
-				if (TotalIconHalfSize.X < 0.5f || TotalIconHalfSize.Y < 0.5f)
-				{
-					DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
-					continue;
-				}
-				
-			#if WITH_EDITOR
-				//Editor has an issue where the given rectangle is not 100% accurate.
-				const FVector2f UsedIconHalfSize = (DrawState.ExtentHalfSize * DrawScale) + (GEditor ? FVector2f(16.f, 32.f) : FVector2f(0.f));
-			#else
-				const FVector2f UsedIconHalfSize = TotalIconHalfSize;
-			#endif
-							
-				const FIntRect::IntPointType DrawItemTopLeft = FIntRect::IntPointType(ToIntPoint(FVector2f(EntityScreenPosition) - UsedIconHalfSize));
-				const FIntRect::IntPointType DrawItemBottomRight = FIntRect::IntPointType(ToIntPoint(FVector2f(EntityScreenPosition) + UsedIconHalfSize));
-				if(!ViewRectangle.Intersect(FIntRect(DrawItemTopLeft, DrawItemBottomRight)))
-				{
-					DrawState.ScreenPosition = FVector3f(-UE_MAX_FLT);
-					continue;
-				}
+			if (!MassSlateDraw::Occlusion::ApplyOcclusion(*OcclusionParameters, Occlusion, DrawState))
+			{
+				continue;
 			}
-
-			DrawState.ScreenPosition = EntityScreenPosition;
 		}
-	});
+
+		DrawState.ScreenPosition = EntityScreenPosition;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,324 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Mass/MassDrawSubsystem.h"
+#include "MassEntitySubsystem.h"
+#include "MassSlateDraw.h"
+#include "Blueprint/WidgetLayoutLibrary.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/UserInterfaceSettings.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Mass/ProgressBarMassDraw.h"
+#include "Mass/SimpleBrushMassDraw.h"
+#include "Slate/SGameLayerManager.h"
+#include "UnrealClient.h"
+
+void UMassDrawSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if (UMassEntitySubsystem* EntitySubsystem = Collection.InitializeDependency<UMassEntitySubsystem>())
+	{
+		EntityManager = EntitySubsystem->GetMutableEntityManager().AsShared();
+	}
+
+	if (UGameInstance* GameInstance = GetWorld()->GetGameInstance())
+	{
+		LocalPlayerAddedHandle = GameInstance->OnLocalPlayerAddedEvent.AddUObject(this, &UMassDrawSubsystem::OnLocalPlayerAdded);
+		LocalPlayerRemovedHandle = GameInstance->OnLocalPlayerRemovedEvent.AddUObject(this, &UMassDrawSubsystem::OnLocalPlayerRemoved);
+	}
+
+	ViewportResizedHandle = FViewport::ViewportResizedEvent.AddUObject(this, &UMassDrawSubsystem::OnViewportResized);
+
+	if (FSlateApplication::IsInitialized())
+	{
+		WindowDPIScaleChangedHandle = FSlateApplication::Get().OnWindowDPIScaleChanged().AddUObject(this, &UMassDrawSubsystem::OnWindowDPIScaleChanged);
+	}
+
+#if WITH_EDITOR
+	ObjectPropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddUObject(this, &UMassDrawSubsystem::OnObjectPropertyChanged);
+#endif
+
+	//Registrations are kept between worlds, only the first world registers the built-in layers.
+	if (bRegisterBuiltInDrawLayers)
+	{
+		if (!IsDrawLayerRegistered(TEXT("MassDraw.SimpleBrush")))
+		{
+			RegisterDrawLayer<FSimpleBrushDrawLayer>(TEXT("MassDraw.SimpleBrush"));
+		}
+		if (!IsDrawLayerRegistered(TEXT("MassDraw.ProgressBar")))
+		{
+			RegisterDrawLayer<FProgressBarDrawLayer>(TEXT("MassDraw.ProgressBar"));
+		}
+	}
+}
+
+void UMassDrawSubsystem::Deinitialize()
+{
+	DeinitializeEvent.Broadcast();
+	DeinitializeEvent.Clear();
+
+	FViewport::ViewportResizedEvent.Remove(ViewportResizedHandle);
+
+	if (FSlateApplication::IsInitialized())
+	{
+		FSlateApplication::Get().OnWindowDPIScaleChanged().Remove(WindowDPIScaleChangedHandle);
+	}
+
+#if WITH_EDITOR
+	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(ObjectPropertyChangedHandle);
+#endif
+
+	if (UGameInstance* GameInstance = GetWorld()->GetGameInstance())
+	{
+		GameInstance->OnLocalPlayerAddedEvent.Remove(LocalPlayerAddedHandle);
+		GameInstance->OnLocalPlayerRemovedEvent.Remove(LocalPlayerRemovedHandle);
+
+		for (ULocalPlayer* LocalPlayer : GameInstance->GetLocalPlayers())
+		{
+			for (const FDrawLayerRegistration& Registration : GetDrawLayerRegistrations())
+			{
+				RemoveDrawLayerForLocalPlayer(LocalPlayer, Registration.LayerName);
+			}
+		}
+	}
+
+	CachedViewportScales.Reset();
+	EntityManager.Reset();
+
+	Super::Deinitialize();
+}
+
+void UMassDrawSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	//Local players usually only have a viewport client by now, catch up on everything registered before.
+	for (const FDrawLayerRegistration& Registration : GetDrawLayerRegistrations())
+	{
+		AddDrawLayerForLocalPlayers(Registration);
+	}
+}
+
+bool UMassDrawSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UMassDrawSubsystem::UnregisterDrawLayer(const FName LayerName)
+{
+	if (GEngine)
+	{
+		for (const FWorldContext& WorldContext : GEngine->GetWorldContexts())
+		{
+			UMassDrawSubsystem* DrawSubsystem = UWorld::GetSubsystem<UMassDrawSubsystem>(WorldContext.World());
+			const UGameInstance* GameInstance = WorldContext.OwningGameInstance;
+			if (!DrawSubsystem || !GameInstance)
+			{
+				continue;
+			}
+
+			for (ULocalPlayer* LocalPlayer : GameInstance->GetLocalPlayers())
+			{
+				DrawSubsystem->RemoveDrawLayerForLocalPlayer(LocalPlayer, LayerName);
+			}
+		}
+	}
+
+	GetDrawLayerRegistrations().RemoveAll([LayerName](const FDrawLayerRegistration& Registration) { return Registration.LayerName == LayerName; });
+}
+
+bool UMassDrawSubsystem::IsDrawLayerRegistered(const FName LayerName)
+{
+	return GetDrawLayerRegistrations().ContainsByPredicate([LayerName](const FDrawLayerRegistration& Registration) { return Registration.LayerName == LayerName; });
+}
+
+void UMassDrawSubsystem::AddDrawLayerRegistration(const FName LayerName, TFunction<TSharedRef<IGameLayer>(const FLocalPlayerContext&)>&& CreateLayer)
+{
+	if (IsDrawLayerRegistered(LayerName))
+	{
+		UE_LOG(LogMassSlateDraw, Warning, TEXT("UMassDrawSubsystem::RegisterDrawLayer - A draw layer named %s is already registered."), *LayerName.ToString());
+		return;
+	}
+
+	FDrawLayerRegistration& Registration = GetDrawLayerRegistrations().AddDefaulted_GetRef();
+	Registration.LayerName = LayerName;
+	Registration.CreateLayer = MoveTemp(CreateLayer);
+
+	if (GEngine)
+	{
+		for (const FWorldContext& WorldContext : GEngine->GetWorldContexts())
+		{
+			if (UMassDrawSubsystem* DrawSubsystem = UWorld::GetSubsystem<UMassDrawSubsystem>(WorldContext.World()))
+			{
+				DrawSubsystem->AddDrawLayerForLocalPlayers(Registration);
+			}
+		}
+	}
+}
+
+TArray<UMassDrawSubsystem::FDrawLayerRegistration>& UMassDrawSubsystem::GetDrawLayerRegistrations()
+{
+	static TArray<FDrawLayerRegistration> DrawLayerRegistrations;
+	return DrawLayerRegistrations;
+}
+
+float UMassDrawSubsystem::GetViewportScale(const ULocalPlayer* LocalPlayer)
+{
+	if (!LocalPlayer || !LocalPlayer->ViewportClient)
+	{
+		return 0.f;
+	}
+
+	const float SlateApplicationScale = FSlateApplication::IsInitialized() ? FSlateApplication::Get().GetApplicationScale() : 1.f;
+	const float UserInterfaceApplicationScale = GetDefault<UUserInterfaceSettings>()->ApplicationScale;
+	if (SlateApplicationScale != CachedSlateApplicationScale || UserInterfaceApplicationScale != CachedUserInterfaceApplicationScale)
+	{
+		InvalidateViewportScales();
+		CachedSlateApplicationScale = SlateApplicationScale;
+		CachedUserInterfaceApplicationScale = UserInterfaceApplicationScale;
+	}
+
+	if (const float* CachedViewportScale = CachedViewportScales.Find(LocalPlayer))
+	{
+		return *CachedViewportScale;
+	}
+
+	const float ViewportScale = UWidgetLayoutLibrary::GetViewportScale(LocalPlayer->ViewportClient);
+	const SIZE_T CachedViewportScalesAllocatedSize = CachedViewportScales.GetAllocatedSize();
+	CachedViewportScales.Add(LocalPlayer, ViewportScale);
+	if (CachedViewportScales.GetAllocatedSize() != CachedViewportScalesAllocatedSize)
+	{
+		INC_DWORD_STAT(STAT_MassDrawCacheGrowths);
+	}
+	return ViewportScale;
+}
+
+void UMassDrawSubsystem::AddDrawLayerForLocalPlayers(const FDrawLayerRegistration& Registration)
+{
+	const UGameInstance* GameInstance = GetWorld()->GetGameInstance();
+	if (!GameInstance)
+	{
+		return;
+	}
+
+	for (ULocalPlayer* LocalPlayer : GameInstance->GetLocalPlayers())
+	{
+		AddDrawLayerForLocalPlayer(LocalPlayer, Registration);
+	}
+}
+
+void UMassDrawSubsystem::AddDrawLayerForLocalPlayer(ULocalPlayer* LocalPlayer, const FDrawLayerRegistration& Registration)
+{
+	if (!LocalPlayer || !LocalPlayer->ViewportClient)
+	{
+		return;
+	}
+
+	const TSharedPtr<IGameLayerManager> LayerManager = LocalPlayer->ViewportClient->GetGameLayerManager();
+	if (!LayerManager.IsValid() || LayerManager->FindLayerForPlayer(LocalPlayer, Registration.LayerName).IsValid())
+	{
+		return;
+	}
+
+	LayerManager->AddLayerForPlayer(LocalPlayer, Registration.LayerName, Registration.CreateLayer(FLocalPlayerContext(LocalPlayer, GetWorld())), -100);
+}
+
+void UMassDrawSubsystem::RemoveDrawLayerForLocalPlayer(ULocalPlayer* LocalPlayer, const FName LayerName)
+{
+	if (!LocalPlayer || !LocalPlayer->ViewportClient)
+	{
+		return;
+	}
+
+	const TSharedPtr<IGameLayerManager> LayerManager = LocalPlayer->ViewportClient->GetGameLayerManager();
+	if (!LayerManager.IsValid())
+	{
+		return;
+	}
+
+	LayerManager->RemoveLayerForPlayer(LocalPlayer, LayerName);
+}
+
+void UMassDrawSubsystem::OnLocalPlayerAdded(ULocalPlayer* LocalPlayer)
+{
+	for (const FDrawLayerRegistration& Registration : GetDrawLayerRegistrations())
+	{
+		AddDrawLayerForLocalPlayer(LocalPlayer, Registration);
+	}
+}
+
+void UMassDrawSubsystem::OnLocalPlayerRemoved(ULocalPlayer* LocalPlayer)
+{
+	for (const FDrawLayerRegistration& Registration : GetDrawLayerRegistrations())
+	{
+		RemoveDrawLayerForLocalPlayer(LocalPlayer, Registration.LayerName);
+	}
+
+	CachedViewportScales.Remove(LocalPlayer);
+}
+
+void UMassDrawSubsystem::OnViewportResized(FViewport* Viewport, uint32 Unused)
+{
+	InvalidateViewportScales();
+}
+
+void UMassDrawSubsystem::OnWindowDPIScaleChanged(TSharedRef<SWindow> Window)
+{
+	InvalidateViewportScales();
+}
+
+#if WITH_EDITOR
+void UMassDrawSubsystem::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent)
+{
+	//Covers edits to the DPI scale rule and curve in the project settings.
+	if (Object && Object->IsA<UUserInterfaceSettings>())
+	{
+		InvalidateViewportScales();
+	}
+}
+#endif
+
+void UMassDrawSubsystem::InvalidateViewportScales()
+{
+	CachedViewportScales.Reset();
+}
+
+int32 UMassDrawSubsystem::RegisterProjectionTarget(const FMassDrawProjectionTarget& Target)
+{
+	for (int32 TargetIndex = 0; TargetIndex < MassSlateDraw::MaxProjectionTargets; TargetIndex++)
+	{
+		if (IsProjectionTargetRegistered(TargetIndex))
+		{
+			continue;
+		}
+
+		ProjectionTargets[TargetIndex] = Target;
+		RegisteredTargetMask |= static_cast<uint8>(1 << TargetIndex);
+		return TargetIndex;
+	}
+
+	UE_LOG(LogMassSlateDraw, Warning, TEXT("UMassDrawSubsystem::RegisterProjectionTarget - All %d projection target slots are in use."), MassSlateDraw::MaxProjectionTargets);
+	return INDEX_NONE;
+}
+
+void UMassDrawSubsystem::UpdateProjectionTarget(int32 TargetIndex, const FMassDrawProjectionTarget& Target)
+{
+	if (!IsProjectionTargetRegistered(TargetIndex))
+	{
+		return;
+	}
+
+	ProjectionTargets[TargetIndex] = Target;
+}
+
+void UMassDrawSubsystem::UnregisterProjectionTarget(int32 TargetIndex)
+{
+	if (!IsProjectionTargetRegistered(TargetIndex))
+	{
+		return;
+	}
+
+	RegisteredTargetMask &= static_cast<uint8>(~(1 << TargetIndex));
+}
\ No newline at end of file
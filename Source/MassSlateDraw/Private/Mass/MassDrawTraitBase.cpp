@@ -3,6 +3,7 @@
 #include "Mass/MassDrawTraitBase.h"
 #include "MassCommonFragments.h"
 #include "MassEntityTemplateRegistry.h"
+#include "MassEntityUtils.h"
 #include "VisualLogger/VisualLogger.h"
 
 UMassDrawTraitBase::UMassDrawTraitBase(const FObjectInitializer& ObjectInitializer)
@@ -29,4 +30,21 @@ void UMassDrawTraitBase::BuildTemplate(FMassEntityTemplateBuildContext& BuildCon
 	StateFragment.ExtentHalfSize = GetBaseExtentHalfSize();
 	
 	BuildContext.RequireFragment<FTransformFragment>();
+
+	if (bProjectToSecondaryTargets)
+	{
+		BuildContext.AddFragment<FMassDrawTargetProjectionFragment>();
+	}
+
+	if (OcclusionMode != EMassDrawOcclusionMode::None)
+	{
+		FMassEntityManager& EntityManager = UE::Mass::Utils::GetEntityManagerChecked(World);
+
+		FMassDrawOcclusionParameters OcclusionParameters;
+		OcclusionParameters.Mode = OcclusionMode;
+		OcclusionParameters.TraceChannel = OcclusionTraceChannel;
+		OcclusionParameters.OccludedOpacity = OccludedOpacity;
+		BuildContext.AddConstSharedFragment(EntityManager.GetOrCreateConstSharedFragment(OcclusionParameters));
+		BuildContext.AddFragment<FMassDrawOcclusionFragment>();
+	}
 }
\ No newline at end of file
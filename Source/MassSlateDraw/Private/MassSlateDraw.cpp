@@ -6,4 +6,6 @@
 IMPLEMENT_MODULE(FMassSlateDrawModule, MassSlateDraw);
 
 DEFINE_LOG_CATEGORY(LogMassSlateDraw)
+
+LLM_DEFINE_TAG(MassDraw);
  
\ No newline at end of file
@@ -0,0 +1,177 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Mass/MassDrawOcclusion.h"
+#include "Mass/MassDrawTraitBase.h"
+#include "Components/BoxComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace MassSlateDraw::Occlusion::Tests
+{
+	//Ticks the world until the pending trace has been consumed. Returns false if it never completed.
+	static bool TickUntilConsumed(UWorld& World, FMassDrawOcclusionFragment& Occlusion)
+	{
+		for (int32 TickIndex = 0; TickIndex < 4; TickIndex++)
+		{
+			World.Tick(LEVELTICK_All, 1.f / 30.f);
+
+			//An expired handle would also be consumed, but without a result.
+			if (!World.IsTraceHandleValid(Occlusion.PendingTrace, false))
+			{
+				return false;
+			}
+
+			if (ConsumeTraceResult(World, Occlusion))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//Runs one frame of the scheduler over VisibleCount entities that can all request a trace. Returns the visit indices that traced.
+	static TArray<int32> RunSchedulerFrame(FTraceScheduler& Scheduler, const int32 VisibleCount, const int32 TraceBudget)
+	{
+		TArray<int32> TracedIndices;
+		Scheduler.BeginFrame(TraceBudget);
+		for (int32 VisitIndex = 0; VisitIndex < VisibleCount; VisitIndex++)
+		{
+			if (Scheduler.VisitEntity(true))
+			{
+				TracedIndices.Add(VisitIndex);
+			}
+		}
+		Scheduler.EndFrame();
+		return TracedIndices;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMassDrawOcclusionTraceTest, "MassSlateDraw.Occlusion.Trace", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FMassDrawOcclusionTraceTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	//Blocking box at the origin. Collision only, nothing needs to be rendered.
+	AActor* Blocker = World->SpawnActor<AActor>();
+	UBoxComponent* BlockerBox = NewObject<UBoxComponent>(Blocker);
+	BlockerBox->SetBoxExtent(FVector(100.0));
+	BlockerBox->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	Blocker->SetRootComponent(BlockerBox);
+	BlockerBox->RegisterComponent();
+	BlockerBox->SetWorldLocation(FVector::ZeroVector);
+
+	FMassDrawOcclusionFragment BlockedOcclusion;
+	BlockedOcclusion.bIsOccluded = false;
+	MassSlateDraw::Occlusion::RequestTrace(*World, FVector(-1000.0, 0.0, 0.0), FVector(1000.0, 0.0, 0.0), ECC_Visibility, BlockedOcclusion);
+
+	FMassDrawOcclusionFragment ClearOcclusion;
+	ClearOcclusion.bIsOccluded = true;
+	MassSlateDraw::Occlusion::RequestTrace(*World, FVector(-1000.0, 0.0, 1000.0), FVector(1000.0, 0.0, 1000.0), ECC_Visibility, ClearOcclusion);
+
+	TestTrue(TEXT("Blocked segment requested a trace"), BlockedOcclusion.PendingTrace.IsValid());
+	TestTrue(TEXT("Clear segment requested a trace"), ClearOcclusion.PendingTrace.IsValid());
+
+	//Both traces were issued in the same frame, so they complete on the same tick.
+	TestTrue(TEXT("Blocked trace completed"), MassSlateDraw::Occlusion::Tests::TickUntilConsumed(*World, BlockedOcclusion));
+	TestTrue(TEXT("Clear trace completed"), MassSlateDraw::Occlusion::ConsumeTraceResult(*World, ClearOcclusion));
+
+	TestTrue(TEXT("Segment through the box is occluded"), BlockedOcclusion.bIsOccluded);
+	TestFalse(TEXT("Segment above the box is not occluded"), ClearOcclusion.bIsOccluded);
+	TestFalse(TEXT("Consumed traces are cleared"), BlockedOcclusion.PendingTrace.IsValid() || ClearOcclusion.PendingTrace.IsValid());
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMassDrawOcclusionTraceSchedulerTest, "MassSlateDraw.Occlusion.TraceScheduler", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FMassDrawOcclusionTraceSchedulerTest::RunTest(const FString& Parameters)
+{
+	using MassSlateDraw::Occlusion::FTraceScheduler;
+	using MassSlateDraw::Occlusion::Tests::RunSchedulerFrame;
+
+	{
+		FTraceScheduler Scheduler;
+		TestEqual(TEXT("Budget covering every visible entity traces all of them"), RunSchedulerFrame(Scheduler, 5, 8), TArray<int32>({0, 1, 2, 3, 4}));
+		TestEqual(TEXT("Budget covering every visible entity starts over"), Scheduler.GetCursor(), 0);
+	}
+
+	{
+		FTraceScheduler Scheduler;
+		TestEqual(TEXT("First half traced"), RunSchedulerFrame(Scheduler, 6, 3), TArray<int32>({0, 1, 2}));
+		TestEqual(TEXT("Cursor resumes after the last traced entity"), Scheduler.GetCursor(), 3);
+		TestEqual(TEXT("Second half traced"), RunSchedulerFrame(Scheduler, 6, 3), TArray<int32>({3, 4, 5}));
+		TestEqual(TEXT("Cursor reaching the visible count wraps to 0"), Scheduler.GetCursor(), 0);
+	}
+
+	{
+		FTraceScheduler Scheduler;
+		RunSchedulerFrame(Scheduler, 6, 4);
+		TestEqual(TEXT("Cursor after the first frame"), Scheduler.GetCursor(), 4);
+		TestEqual(TEXT("Leftover budget is spent on the entities before the cursor"), RunSchedulerFrame(Scheduler, 6, 4), TArray<int32>({0, 1, 4, 5}));
+		TestEqual(TEXT("Cursor resumes after the last wrapped trace"), Scheduler.GetCursor(), 2);
+	}
+
+	{
+		FTraceScheduler Scheduler;
+		RunSchedulerFrame(Scheduler, 10, 8);
+		TestEqual(TEXT("Cursor before the visible count shrinks"), Scheduler.GetCursor(), 8);
+		TestEqual(TEXT("Entities before a cursor past the visible count still get traced"), RunSchedulerFrame(Scheduler, 4, 8), TArray<int32>({0, 1, 2, 3}));
+		TestEqual(TEXT("Cursor starts over once every visible entity got a trace"), Scheduler.GetCursor(), 0);
+	}
+
+	{
+		FTraceScheduler Scheduler;
+		Scheduler.BeginFrame(1);
+		TestFalse(TEXT("Entities with a trace in flight don't use budget"), Scheduler.VisitEntity(false));
+		TestTrue(TEXT("Budget goes to the next entity"), Scheduler.VisitEntity(true));
+		TestFalse(TEXT("Budget is exhausted"), Scheduler.VisitEntity(true));
+		Scheduler.EndFrame();
+		TestEqual(TEXT("Cursor resumes after the traced entity"), Scheduler.GetCursor(), 2);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMassDrawOcclusionApplyTest, "MassSlateDraw.Occlusion.Apply", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::EngineFilter)
+
+bool FMassDrawOcclusionApplyTest::RunTest(const FString& Parameters)
+{
+	FMassDrawOcclusionFragment Occlusion;
+	Occlusion.bIsOccluded = true;
+
+	FMassDrawOcclusionParameters HideParameters;
+	HideParameters.Mode = EMassDrawOcclusionMode::Hide;
+	FMassDrawStateFragment HiddenState;
+	HiddenState.ScreenPosition = FVector3f(100.f, 100.f, 1.f);
+	TestFalse(TEXT("Hide culls occluded icons"), MassSlateDraw::Occlusion::ApplyOcclusion(HideParameters, Occlusion, HiddenState));
+	TestEqual(TEXT("Hide moves occluded icons off screen"), HiddenState.ScreenPosition, FVector3f(-UE_MAX_FLT));
+
+	FMassDrawOcclusionParameters FadeParameters;
+	FadeParameters.Mode = EMassDrawOcclusionMode::Fade;
+	FadeParameters.OccludedOpacity = 0.25f;
+	FMassDrawStateFragment FadedState;
+	TestTrue(TEXT("Fade keeps occluded icons"), MassSlateDraw::Occlusion::ApplyOcclusion(FadeParameters, Occlusion, FadedState));
+	TestEqual(TEXT("Fade applies the occluded opacity"), FadedState.Opacity, FadeParameters.OccludedOpacity);
+
+	Occlusion.bIsOccluded = false;
+	FMassDrawStateFragment VisibleState;
+	TestTrue(TEXT("Visible icons are kept"), MassSlateDraw::Occlusion::ApplyOcclusion(HideParameters, Occlusion, VisibleState));
+	TestEqual(TEXT("Visible icons keep full opacity"), VisibleState.Opacity, 1.f);
+
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "Engine/EngineTypes.h"
+#include "WorldCollision.h"
+#include "MassDrawOcclusion.generated.h"
+
+struct FMassDrawStateFragment;
+
+UENUM()
+enum class EMassDrawOcclusionMode : uint8
+{
+	//Icons are drawn regardless of world geometry between them and the camera.
+	None,
+	//Occluded icons are culled entirely.
+	Hide,
+	//Occluded icons are drawn with a reduced opacity.
+	Fade
+};
+
+//Shared occlusion settings for all entities built from the same draw trait.
+USTRUCT()
+struct MASSSLATEDRAW_API FMassDrawOcclusionParameters : public FMassConstSharedFragment
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	EMassDrawOcclusionMode Mode = EMassDrawOcclusionMode::Hide;
+	UPROPERTY()
+	TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+	//Opacity applied to occluded icons when Mode is Fade.
+	UPROPERTY()
+	float OccludedOpacity = 0.35f;
+};
+
+//Per entity occlusion state. Holds the cached result of the last completed trace as well as any trace still in flight.
+USTRUCT()
+struct MASSSLATEDRAW_API FMassDrawOcclusionFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FTraceHandle PendingTrace;
+	UPROPERTY()
+	bool bIsOccluded = false;
+};
+
+//Occlusion trace helpers. Only depend on a world's physics scene so they can be driven without a viewport or renderer.
+namespace MassSlateDraw::Occlusion
+{
+	//Queues an async line trace from ViewOrigin to TargetPosition. Results become available on the following frame.
+	MASSSLATEDRAW_API void RequestTrace(UWorld& World, const FVector& ViewOrigin, const FVector& TargetPosition, const ECollisionChannel TraceChannel, FMassDrawOcclusionFragment& Occlusion);
+
+	//Updates the cached occlusion result if the pending trace has completed. Expired traces are discarded so they can be requested again.
+	//Returns true if the fragment no longer has a trace in flight.
+	MASSSLATEDRAW_API bool ConsumeTraceResult(UWorld& World, FMassDrawOcclusionFragment& Occlusion);
+
+	//Applies the cached occlusion result to an icon that is on screen. Returns false if the icon got hidden.
+	MASSSLATEDRAW_API bool ApplyOcclusion(const FMassDrawOcclusionParameters& Parameters, const FMassDrawOcclusionFragment& Occlusion, FMassDrawStateFragment& DrawState);
+
+	//Time slices occlusion traces over frames. Visible entities are visited in query order, once the budget runs out
+	//the next frame resumes after the last entity traced and any budget left at the end is spent from the start of the list.
+	struct MASSSLATEDRAW_API FTraceScheduler
+	{
+		void BeginFrame(const int32 TraceBudget);
+		//Called once per visible entity, in query order. Returns true if the entity should request a trace.
+		bool VisitEntity(const bool bCanRequestTrace);
+		void EndFrame();
+
+		FORCEINLINE int32 GetCursor() const { return Cursor; }
+
+	private:
+		//Visit index of the first entity allowed to trace before the ones preceding it.
+		int32 Cursor = 0;
+		//Always greater than Cursor unless both are 0.
+		int32 LastVisibleCount = 0;
+		int32 TracesRemaining = 0;
+		//Budget kept for the entities after the cursor while visiting the ones before it, estimated from LastVisibleCount.
+		int32 BudgetReservedAfterCursor = 0;
+		int32 VisitIndex = 0;
+		int32 LastTraceIndex = INDEX_NONE;
+		int32 LastWrappedTraceIndex = INDEX_NONE;
+	};
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "MassProcessor.h"
+#include "Mass/MassDrawSubsystem.h"
 #include "MassDrawProjectionProcessor.generated.h"
 
 //Processor responsible for taking all FMassDrawStateFragment fragments and updating their projection information for the current frame.
@@ -17,5 +18,27 @@ protected:
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 
 private:
+	void ProjectChunk(FMassExecutionContext& LocalContext);
+
+	//Per frame state read by ProjectChunk.
+	struct FFrameData
+	{
+		UWorld* World = nullptr;
+		FIntRect ViewRect;
+		FVector4f ViewRectFloat;
+		FMatrix ViewProjectionMatrix;
+		FVector ViewOrigin;
+		float ViewportScale = 1.f;
+		bool bMainViewValid = false;
+		bool bPerformPreculling = true;
+
+		TArray<TPair<int32, FMassDrawProjectionTarget>, TInlineAllocator<MassSlateDraw::MaxProjectionTargets>> ProjectionTargets;
+		TArray<FVector2f, TInlineAllocator<MassSlateDraw::MaxProjectionTargets>> TargetCenters;
+	};
+
 	FMassEntityQuery DrawProjectionQuery;
+	FMassExecuteFunction ProjectChunkFunction;
+	FFrameData FrameData;
+
+	MassSlateDraw::Occlusion::FTraceScheduler OcclusionTraceScheduler;
 };
\ No newline at end of file
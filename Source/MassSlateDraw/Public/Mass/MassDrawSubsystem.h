@@ -0,0 +1,139 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/LocalPlayer.h"
+#include "Mass/MassDrawTraitBase.h"
+#include "MassDrawSubsystem.generated.h"
+
+struct FMassEntityManager;
+struct FPropertyChangedEvent;
+class IGameLayer;
+class FViewport;
+class SWindow;
+
+//Orthographic top-down projection used by secondary draw targets such as minimaps or radars.
+//World +X maps to viewport up and world +Y maps to viewport right.
+USTRUCT(BlueprintType)
+struct MASSSLATEDRAW_API FMassDrawProjectionTarget
+{
+	GENERATED_BODY()
+
+	FORCEINLINE FVector2f GetViewRectCenter() const { return FVector2f((ViewRect.X + ViewRect.Z) * 0.5f, (ViewRect.Y + ViewRect.W) * 0.5f); }
+
+public:
+	//Viewport space rectangle (Min X, Min Y, Max X, Max Y) this target is drawn into.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Projection)
+	FVector4f ViewRect = FVector4f(0.f, 0.f, 256.f, 256.f);
+	//World location shown at the center of ViewRect.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Projection)
+	FVector WorldCenter = FVector(0.0);
+	//Viewport pixels per world unit.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Projection)
+	float WorldToViewScale = 0.01f;
+	//Scale applied to icon sizes when drawn on this target.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Projection)
+	float IconScale = 0.5f;
+};
+
+/**
+ * World subsystem owning everything MassDraw layers need at paint time.
+ * - Creates the registered draw layers for every local player, including players added later on. Registrations are shared by every world.
+ * - Caches the entity manager and each local player's viewport scale (invalidated when a viewport is resized or the DPI / application scale changes).
+ * - Holds the secondary projection targets UMassDrawProjectionProcessor computes alongside the main view.
+ */
+UCLASS(Config=Game)
+class MASSSLATEDRAW_API UMassDrawSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+//~ Begin UWorldSubsystem Interface
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+//~ End UWorldSubsystem Interface
+
+public:
+	//Registers a TMassDrawLayer subclass to be added for every current and future local player of every game world.
+	//Registrations survive map changes until unregistered. Layer names are unique, registering a name a second time is ignored.
+	template<typename TDrawLayer>
+	static void RegisterDrawLayer(const FName LayerName, const int32 ProjectionTargetIndex = INDEX_NONE)
+	{
+		AddDrawLayerRegistration(LayerName, [ProjectionTargetIndex](const FLocalPlayerContext& PlayerContext) -> TSharedRef<IGameLayer>
+		{
+			return MakeShareable(new TDrawLayer(PlayerContext, ProjectionTargetIndex));
+		});
+	}
+	static void UnregisterDrawLayer(const FName LayerName);
+	static bool IsDrawLayerRegistered(const FName LayerName);
+
+	FORCEINLINE FMassEntityManager* GetEntityManager() const { return EntityManager.Get(); }
+	//Broadcast on deinitialization, before the entity manager is released.
+	FORCEINLINE FSimpleMulticastDelegate& OnDeinitialize() { return DeinitializeEvent; }
+	//Returns the cached viewport scale of the given local player, or 0 if it has no viewport.
+	float GetViewportScale(const ULocalPlayer* LocalPlayer);
+
+	//Returns the index of the registered target, or INDEX_NONE if all MassSlateDraw::MaxProjectionTargets slots are in use.
+	UFUNCTION(BlueprintCallable, Category="Mass Draw")
+	int32 RegisterProjectionTarget(const FMassDrawProjectionTarget& Target);
+	UFUNCTION(BlueprintCallable, Category="Mass Draw")
+	void UpdateProjectionTarget(int32 TargetIndex, const FMassDrawProjectionTarget& Target);
+	UFUNCTION(BlueprintCallable, Category="Mass Draw")
+	void UnregisterProjectionTarget(int32 TargetIndex);
+
+	FORCEINLINE bool IsProjectionTargetRegistered(const int32 TargetIndex) const { return TargetIndex >= 0 && TargetIndex < MassSlateDraw::MaxProjectionTargets && (RegisteredTargetMask & (1 << TargetIndex)) != 0; }
+	FORCEINLINE const FMassDrawProjectionTarget& GetProjectionTarget(const int32 TargetIndex) const { return ProjectionTargets[TargetIndex]; }
+	FORCEINLINE const TStaticArray<FMassDrawProjectionTarget, MassSlateDraw::MaxProjectionTargets>& GetProjectionTargets() const { return ProjectionTargets; }
+	FORCEINLINE uint8 GetRegisteredTargetMask() const { return RegisteredTargetMask; }
+
+private:
+	struct FDrawLayerRegistration
+	{
+		FName LayerName;
+		TFunction<TSharedRef<IGameLayer>(const FLocalPlayerContext&)> CreateLayer;
+	};
+
+	static void AddDrawLayerRegistration(const FName LayerName, TFunction<TSharedRef<IGameLayer>(const FLocalPlayerContext&)>&& CreateLayer);
+	//Lives at module level so registrations outlive the world they were made in.
+	static TArray<FDrawLayerRegistration>& GetDrawLayerRegistrations();
+
+	void AddDrawLayerForLocalPlayers(const FDrawLayerRegistration& Registration);
+	void AddDrawLayerForLocalPlayer(ULocalPlayer* LocalPlayer, const FDrawLayerRegistration& Registration);
+	void RemoveDrawLayerForLocalPlayer(ULocalPlayer* LocalPlayer, const FName LayerName);
+
+	void OnLocalPlayerAdded(ULocalPlayer* LocalPlayer);
+	void OnLocalPlayerRemoved(ULocalPlayer* LocalPlayer);
+	void OnViewportResized(FViewport* Viewport, uint32 Unused);
+	void OnWindowDPIScaleChanged(TSharedRef<SWindow> Window);
+#if WITH_EDITOR
+	void OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent);
+#endif
+	void InvalidateViewportScales();
+
+	//If true, the simple brush and progress bar layers are registered on initialization as "MassDraw.SimpleBrush" and "MassDraw.ProgressBar".
+	//Off by default so projects creating these layers themselves through TMassDrawLayer::CreateLayerForLocalPlayer don't draw them twice.
+	UPROPERTY(Config)
+	bool bRegisterBuiltInDrawLayers = false;
+
+	TSharedPtr<FMassEntityManager> EntityManager;
+	FSimpleMulticastDelegate DeinitializeEvent;
+	TMap<TObjectKey<ULocalPlayer>, float> CachedViewportScales;
+	//Scale factors the cached viewport scales were computed with. Polled since there are no change events for them outside the editor.
+	float CachedSlateApplicationScale = 1.f;
+	float CachedUserInterfaceApplicationScale = 1.f;
+	FDelegateHandle LocalPlayerAddedHandle;
+	FDelegateHandle LocalPlayerRemovedHandle;
+	FDelegateHandle ViewportResizedHandle;
+	FDelegateHandle WindowDPIScaleChangedHandle;
+#if WITH_EDITOR
+	FDelegateHandle ObjectPropertyChangedHandle;
+#endif
+
+	TStaticArray<FMassDrawProjectionTarget, MassSlateDraw::MaxProjectionTargets> ProjectionTargets;
+	uint8 RegisteredTargetMask = 0;
+};
\ No newline at end of file
@@ -8,9 +8,18 @@
 #include "Styling/SlateBrush.h"
 #include "VisualLogger/VisualLogger.h"
 #include "MassSlateDraw.h"
+#include "Mass/MassDrawOcclusion.h"
 #include "MassDrawTraitBase.generated.h"
 
 DECLARE_CYCLE_STAT(TEXT("MassDraw - OnPaint"), STAT_MassDrawOnPaint, STATGROUP_MassDraw);
+DECLARE_DWORD_COUNTER_STAT(TEXT("MassDraw - Painted Icons"), STAT_MassDrawPaintedIcons, STATGROUP_MassDraw);
+
+namespace MassSlateDraw
+{
+	//Maximum number of secondary projection targets (minimaps, radars, etc) that can be registered with UMassDrawSubsystem at once.
+	//Kept small since every entity projecting to secondary targets stores a position per slot.
+	static constexpr int32 MaxProjectionTargets = 4;
+}
 
 //Struct that represents a simplified FSlateBrush. Used instead of FSlateBrush to reduce struct size.
 USTRUCT(BlueprintType)
@@ -59,10 +68,28 @@ struct MASSSLATEDRAW_API FMassDrawStateFragment : public FMassFragment
 	FVector3f ScreenPosition = FVector3f(-UE_MAX_FLT);
 	UPROPERTY()
 	float DistanceScale = -1.f;
+	//Multiplied into the draw tint. Lowered by the projection processor for faded occluded icons.
+	UPROPERTY()
+	float Opacity = 1.f;
 	UPROPERTY()
 	bool bIsEnabled = true;
 };
 
+//Fragment containing the positions of an icon on each registered secondary projection target.
+//Filled in by UMassDrawProjectionProcessor in the same pass as FMassDrawStateFragment.
+USTRUCT()
+struct MASSSLATEDRAW_API FMassDrawTargetProjectionFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FORCEINLINE bool IsVisibleOnTarget(const int32 TargetIndex) const { return (VisibleTargetMask & (1 << TargetIndex)) != 0; }
+
+	//Only valid for targets flagged in VisibleTargetMask.
+	FVector2f TargetPositions[MassSlateDraw::MaxProjectionTargets];
+	UPROPERTY()
+	uint8 VisibleTargetMask = 0;
+};
+
 /**
  * Base trait for any MassDraw trait. Abstract and meant to be subclassed.
  * See UMassDrawTraitBase or UMassDrawProgressBarTrait for example implementations of this trait.
@@ -85,4 +112,15 @@ protected:
 	FVector WorldOffset = FVector(0.0);
 	UPROPERTY(Category="Draw", EditDefaultsOnly)
 	float DistanceScaling = -1.f;
+	//If true, icons are also projected onto secondary targets registered with UMassDrawSubsystem (minimaps, radars, etc).
+	UPROPERTY(Category="Draw", EditDefaultsOnly)
+	bool bProjectToSecondaryTargets = false;
+
+	//If not None, icons are tested for world geometry between them and the camera using async line traces.
+	UPROPERTY(Category="Occlusion", EditDefaultsOnly)
+	EMassDrawOcclusionMode OcclusionMode = EMassDrawOcclusionMode::None;
+	UPROPERTY(Category="Occlusion", EditDefaultsOnly, meta=(EditCondition="OcclusionMode != EMassDrawOcclusionMode::None"))
+	TEnumAsByte<ECollisionChannel> OcclusionTraceChannel = ECC_Visibility;
+	UPROPERTY(Category="Occlusion", EditDefaultsOnly, meta=(EditCondition="OcclusionMode == EMassDrawOcclusionMode::Fade", ClampMin="0.0", ClampMax="1.0"))
+	float OccludedOpacity = 0.35f;
 };
\ No newline at end of file
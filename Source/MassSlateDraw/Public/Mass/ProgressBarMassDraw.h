@@ -32,8 +32,8 @@ struct MASSSLATEDRAW_API FProgressBarSlateFragment : public FMassFragment
 class FProgressBarDrawLayer final : public TMassDrawLayer<FProgressBarSlateFragment>
 {
 public:
-	explicit FProgressBarDrawLayer(const FLocalPlayerContext& PlayerContext)
-		: TMassDrawLayer(PlayerContext) {}
+	explicit FProgressBarDrawLayer(const FLocalPlayerContext& PlayerContext, const int32 InProjectionTargetIndex = INDEX_NONE)
+		: TMassDrawLayer(PlayerContext, InProjectionTargetIndex) {}
 };
 
 UCLASS(BlueprintType, EditInlineNew, meta=(DisplayName="Draw Progress Bar Trait"))
@@ -35,8 +35,8 @@ struct MASSSLATEDRAW_API FSimpleBrushSlateFragment : public FMassFragment
 class MASSSLATEDRAW_API FSimpleBrushDrawLayer final : public TMassDrawLayer<FSimpleBrushSlateFragment>
 {
 public:
-	explicit FSimpleBrushDrawLayer(const FLocalPlayerContext& PlayerContext)
-		: TMassDrawLayer(PlayerContext) {}
+	explicit FSimpleBrushDrawLayer(const FLocalPlayerContext& PlayerContext, const int32 InProjectionTargetIndex = INDEX_NONE)
+		: TMassDrawLayer(PlayerContext, InProjectionTargetIndex) {}
 };
 
 UCLASS(BlueprintType, EditInlineNew, meta=(DisplayName="Draw Simple Brush Trait"))
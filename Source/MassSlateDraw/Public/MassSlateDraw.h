@@ -4,11 +4,18 @@
 
 #include "CoreMinimal.h"
 #include "Modules/ModuleInterface.h"
+#include "HAL/LowLevelMemTracker.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogMassSlateDraw, Log, All);
 
 DECLARE_STATS_GROUP(TEXT("MassDraw"), STATGROUP_MassDraw, STATCAT_Advanced);
 
+//Growth of the caches MassDraw keeps between frames: query archetypes, layer execution contexts and viewport scales.
+DECLARE_DWORD_COUNTER_STAT(TEXT("MassDraw - Cache Growths"), STAT_MassDrawCacheGrowths, STATGROUP_MassDraw);
+
+//Memory allocated while projecting or painting mass draw icons is attributed to this tag.
+LLM_DECLARE_TAG_API(MassDraw, MASSSLATEDRAW_API);
+
 class FMassSlateDrawModule : public IModuleInterface
 {
 //~ Begin IModuleInterface Interface
@@ -2,11 +2,10 @@
 
 #pragma once
 
-#include "MassEntitySubsystem.h"
 #include "MassExecutionContext.h"
-#include "Blueprint/WidgetLayoutLibrary.h"
 #include "Components/Widget.h"
 #include "Engine/LocalPlayer.h"
+#include "Mass/MassDrawSubsystem.h"
 #include "Mass/MassDrawTraitBase.h"
 #include "Slate/SGameLayerManager.h"
 #include "Widgets/DeclarativeSyntaxSupport.h"
@@ -14,6 +13,7 @@
 
 //Template class for a game layer representing a specific MassDrawFragment.
 //This is the same as UWidgetComponent's IGameLayer implementation but templated for easier creation of layers.
+//If given a projection target index, the layer draws the icons projected onto that UMassDrawSubsystem target (minimap, radar, etc) instead of the main view.
 template<typename MassDrawFragment>
 class TMassDrawLayer : public IGameLayer
 {	
@@ -26,80 +26,189 @@ public:
 	
 
 	public:
-		void Construct(const FArguments& InArgs, const FLocalPlayerContext& InPlayerContext)
+		void Construct(const FArguments& InArgs, const FLocalPlayerContext& InPlayerContext, const int32 InProjectionTargetIndex)
 		{
 			PlayerContext = InPlayerContext;
+			ProjectionTargetIndex = InProjectionTargetIndex;
+			DrawSubsystem = UWorld::GetSubsystem<UMassDrawSubsystem>(PlayerContext.GetWorld());
 			bCanSupportFocus = false;
 			SetVisibility(EVisibility::HitTestInvisible);
+
+			//Layers can outlive their world, don't let the execution context keep its entity manager alive.
+			if (UMassDrawSubsystem* MassDrawSubsystem = DrawSubsystem.Get())
+			{
+				MassDrawSubsystem->OnDeinitialize().AddSP(SharedThis(this), &SMassDrawScreenLayer::ResetExecutionContext);
+			}
+
+			DrawQuery.AddRequirement<FMassDrawStateFragment>(EMassFragmentAccess::ReadOnly);
+			if (ProjectionTargetIndex != INDEX_NONE)
+			{
+				DrawQuery.AddRequirement<FMassDrawTargetProjectionFragment>(EMassFragmentAccess::ReadOnly);
+			}
+			DrawQuery.AddRequirement<MassDrawFragment>(EMassFragmentAccess::ReadOnly);
+
+			if (ProjectionTargetIndex != INDEX_NONE)
+			{
+				PaintChunkFunction = [this](FMassExecutionContext& Context) { PaintProjectionTargetChunk(Context); };
+			}
+			else
+			{
+				PaintChunkFunction = [this](FMassExecutionContext& Context) { PaintChunk(Context); };
+			}
 		}
 		
 		virtual int32 OnPaint(const FPaintArgs& Args, const FGeometry& AllottedGeometry, const FSlateRect& MyCullingRect, FSlateWindowElementList& OutDrawElements, int32 LayerId, const FWidgetStyle& InWidgetStyle, bool bParentEnabled) const override
 		{
-			const UWorld* World = PlayerContext.GetWorld();
+			LLM_SCOPE_BYTAG(MassDraw);
+			UMassDrawSubsystem* MassDrawSubsystem = DrawSubsystem.Get();
+			FMassEntityManager* EntityManager = MassDrawSubsystem ? MassDrawSubsystem->GetEntityManager() : nullptr;
 
-			if (!World)
+			if (!EntityManager)
 			{
+				ResetExecutionContext();
 				return LayerId;
 			}
 	
-			FPaintGeometry PaintGeometry = AllottedGeometry.ToPaintGeometry();
-			const FLinearColor MasterTint = FLinearColor::White;
-
-			UMassEntitySubsystem* EntitySubsystem = UWorld::GetSubsystem<UMassEntitySubsystem>(PlayerContext.GetWorld());
-			if (!EntitySubsystem)
+			const float ViewportScale = MassDrawSubsystem->GetViewportScale(PlayerContext.GetLocalPlayer());
+			if (ViewportScale <= 0.f)
 			{
 				return LayerId;
 			}
-			
-			FMassEntityManager& EntityManager = EntitySubsystem->GetMutableEntityManager();
-	
-			const UGameViewportClient* ViewportClient = World->GetGameViewport();
-			if(!ViewportClient)
+
+			PaintParams.OutDrawElements = &OutDrawElements;
+			PaintParams.PaintGeometry = AllottedGeometry.ToPaintGeometry();
+			PaintParams.ClippingRect = MyCullingRect;
+			PaintParams.DrawScale = ViewportScale;
+			PaintParams.MasterTint = FLinearColor::White;
+			PaintParams.LayerId = LayerId;
+			PaintParams.NumPaintedIcons = 0;
+
+			if (ProjectionTargetIndex != INDEX_NONE)
 			{
-				return LayerId;
+				if (!MassDrawSubsystem->IsProjectionTargetRegistered(ProjectionTargetIndex))
+				{
+					return LayerId;
+				}
+
+				//Icons are only culled by extent in the projection processor, clip whatever overhangs the target's rectangle.
+				const FMassDrawProjectionTarget& Target = MassDrawSubsystem->GetProjectionTarget(ProjectionTargetIndex);
+				PaintParams.ClippingRect = FSlateRect(Target.ViewRect.X, Target.ViewRect.Y, Target.ViewRect.Z, Target.ViewRect.W);
+				PaintParams.DrawScale = ViewportScale * Target.IconScale;
+				OutDrawElements.PushClip(FSlateClippingZone(PaintParams.ClippingRect));
 			}
-	
-			const float ViewportScale = UWidgetLayoutLibrary::GetViewportScale(ViewportClient);
-			
-			FMassExecutionContext ExecutionContext(EntityManager);
-			FMassEntityQuery Query;
-			Query.AddRequirement<FMassDrawStateFragment>(EMassFragmentAccess::ReadOnly);
-			Query.AddRequirement<MassDrawFragment>(EMassFragmentAccess::ReadOnly);
-	
-			Query.ForEachEntityChunk(EntityManager, ExecutionContext, [&OutDrawElements, PaintGeometry, MyCullingRect, ViewportScale, MasterTint, LayerId](FMassExecutionContext& Context)
+
+			if (!ExecutionContext.IsSet())
 			{
-				SCOPE_CYCLE_COUNTER(STAT_MassDrawOnPaint);
-				const TConstArrayView<FMassDrawStateFragment> StateDataList = Context.GetFragmentView<FMassDrawStateFragment>();
-				const TConstArrayView<MassDrawFragment> DrawDataList = Context.GetFragmentView<MassDrawFragment>();
+				ExecutionContext.Emplace(*EntityManager);
+				INC_DWORD_STAT(STAT_MassDrawCacheGrowths);
+			}
 
-				FPaintGeometry CurrentPaintGeometry = FPaintGeometry(PaintGeometry);
-				FSlateClippingZone ClippingZone(MyCullingRect);
+			const int32 NumCachedArchetypes = DrawQuery.GetArchetypes().Num();
+			DrawQuery.ForEachEntityChunk(*EntityManager, ExecutionContext.GetValue(), PaintChunkFunction);
+			if (DrawQuery.GetArchetypes().Num() != NumCachedArchetypes)
+			{
+				INC_DWORD_STAT(STAT_MassDrawCacheGrowths);
+			}
+
+			if (ProjectionTargetIndex != INDEX_NONE)
+			{
+				OutDrawElements.PopClip();
+			}
 
-				const int32 NumEntities = Context.GetNumEntities();
-				for (int32 Index = NumEntities - 1; Index >= 0; Index--)
+			INC_DWORD_STAT_BY(STAT_MassDrawPaintedIcons, PaintParams.NumPaintedIcons);
+			PaintParams.OutDrawElements = nullptr;
+			return LayerId;
+		}
+
+		virtual FVector2D ComputeDesiredSize(float) const override { return FVector2D(0, 0); }
+
+	private:
+		void ResetExecutionContext() const
+		{
+			ExecutionContext.Reset();
+		}
+
+		void PaintChunk(FMassExecutionContext& Context) const
+		{
+			SCOPE_CYCLE_COUNTER(STAT_MassDrawOnPaint);
+			const TConstArrayView<FMassDrawStateFragment> StateDataList = Context.GetFragmentView<FMassDrawStateFragment>();
+			const TConstArrayView<MassDrawFragment> DrawDataList = Context.GetFragmentView<MassDrawFragment>();
+
+			FPaintGeometry CurrentPaintGeometry = FPaintGeometry(PaintParams.PaintGeometry);
+			FSlateClippingZone ClippingZone(PaintParams.ClippingRect);
+			const float ViewportScale = PaintParams.DrawScale;
+			const FLinearColor& MasterTint = PaintParams.MasterTint;
+
+			const int32 NumEntities = Context.GetNumEntities();
+			for (int32 Index = NumEntities - 1; Index >= 0; Index--)
+			{
+				const FMassDrawStateFragment& StateData = StateDataList[Index];
+
+				if(!StateData.bIsEnabled || StateData.ScreenPosition == FVector3f(-UE_MAX_FLT))
 				{
-					const FMassDrawStateFragment& StateData = StateDataList[Index];
+					continue;
+				}
 
-					if(!StateData.bIsEnabled || StateData.ScreenPosition == FVector3f(-UE_MAX_FLT))
-					{
-						continue;
-					}
+				const float DrawScale = StateData.DistanceScale != -1.f ? ViewportScale * (1.f - ((StateData.ScreenPosition.Z - StateData.DistanceScale) / StateData.DistanceScale)) : ViewportScale;					
+				const FLinearColor DrawTint = StateData.Opacity < 1.f ? MasterTint.CopyWithNewOpacity(MasterTint.A * StateData.Opacity) : MasterTint;
+				MassDrawFragment::Draw(StateData, DrawDataList[Index], DrawScale, ClippingZone, CurrentPaintGeometry, *PaintParams.OutDrawElements, DrawTint, PaintParams.LayerId);
+				PaintParams.NumPaintedIcons++;
+			}
+		}
+
+		void PaintProjectionTargetChunk(FMassExecutionContext& Context) const
+		{
+			SCOPE_CYCLE_COUNTER(STAT_MassDrawOnPaint);
+			const TConstArrayView<FMassDrawStateFragment> StateDataList = Context.GetFragmentView<FMassDrawStateFragment>();
+			const TConstArrayView<FMassDrawTargetProjectionFragment> TargetProjectionList = Context.GetFragmentView<FMassDrawTargetProjectionFragment>();
+			const TConstArrayView<MassDrawFragment> DrawDataList = Context.GetFragmentView<MassDrawFragment>();
+
+			FPaintGeometry CurrentPaintGeometry = FPaintGeometry(PaintParams.PaintGeometry);
+			FSlateClippingZone ClippingZone(PaintParams.ClippingRect);
+			const int32 TargetIndex = ProjectionTargetIndex;
+
+			const int32 NumEntities = Context.GetNumEntities();
+			for (int32 Index = NumEntities - 1; Index >= 0; Index--)
+			{
+				const FMassDrawTargetProjectionFragment& TargetProjection = TargetProjectionList[Index];
 
-					const float DrawScale = StateData.DistanceScale != -1.f ? ViewportScale * (1.f - ((StateData.ScreenPosition.Z - StateData.DistanceScale) / StateData.DistanceScale)) : ViewportScale;					
-					MassDrawFragment::Draw(StateData, DrawDataList[Index], DrawScale, ClippingZone, CurrentPaintGeometry, OutDrawElements, MasterTint, LayerId);
+				if (!TargetProjection.IsVisibleOnTarget(TargetIndex))
+				{
+					continue;
 				}
-			});
-			
-			return LayerId;
+
+				//Draw functions read the screen position from the state fragment, so hand them a copy positioned on the target.
+				FMassDrawStateFragment TargetStateData = StateDataList[Index];
+				TargetStateData.ScreenPosition = FVector3f(TargetProjection.TargetPositions[TargetIndex].X, TargetProjection.TargetPositions[TargetIndex].Y, 0.f);
+				MassDrawFragment::Draw(TargetStateData, DrawDataList[Index], PaintParams.DrawScale, ClippingZone, CurrentPaintGeometry, *PaintParams.OutDrawElements, PaintParams.MasterTint, PaintParams.LayerId);
+				PaintParams.NumPaintedIcons++;
+			}
 		}
 
-		virtual FVector2D ComputeDesiredSize(float) const override { return FVector2D(0, 0); }
+		//Per paint state read by the chunk functions.
+		struct FPaintParams
+		{
+			FSlateWindowElementList* OutDrawElements = nullptr;
+			FPaintGeometry PaintGeometry;
+			FSlateRect ClippingRect;
+			float DrawScale = 1.f;
+			FLinearColor MasterTint = FLinearColor::White;
+			int32 LayerId = 0;
+			int32 NumPaintedIcons = 0;
+		};
 	
 	protected:
 		FLocalPlayerContext PlayerContext;
+		int32 ProjectionTargetIndex = INDEX_NONE;
+		TWeakObjectPtr<UMassDrawSubsystem> DrawSubsystem;
+		mutable FMassEntityQuery DrawQuery;
+		mutable TOptional<FMassExecutionContext> ExecutionContext;
+		mutable FPaintParams PaintParams;
+		FMassExecuteFunction PaintChunkFunction;
 	};
 	
-	static TSharedPtr<IGameLayer> CreateLayerForLocalPlayer(ULocalPlayer* LocalPlayer, UWorld* WorldContext, const FName& LayerName)
+	//Prefer UMassDrawSubsystem::RegisterDrawLayer, which also handles local players added after registration.
+	static TSharedPtr<IGameLayer> CreateLayerForLocalPlayer(ULocalPlayer* LocalPlayer, UWorld* WorldContext, const FName& LayerName, const int32 ProjectionTargetIndex = INDEX_NONE)
 	{
 		if (!LocalPlayer || !LocalPlayer->ViewportClient)
 		{
@@ -116,7 +225,7 @@ public:
 		const TSharedPtr<IGameLayer> Layer = LayerManager->FindLayerForPlayer(LocalPlayer, LayerName);
 		if (!Layer.IsValid())
 		{
-			TSharedRef<IGameLayer> NewScreenLayer = MakeShareable(new TMassDrawLayer(FLocalPlayerContext(LocalPlayer, WorldContext)));
+			TSharedRef<IGameLayer> NewScreenLayer = MakeShareable(new TMassDrawLayer(FLocalPlayerContext(LocalPlayer, WorldContext), ProjectionTargetIndex));
 			LayerManager->AddLayerForPlayer(LocalPlayer, LayerName, NewScreenLayer, -100);
 			return NewScreenLayer;
 		}
@@ -124,9 +233,10 @@ public:
 		return Layer;
 	}
 
-	TMassDrawLayer(const FLocalPlayerContext& PlayerContext)
+	TMassDrawLayer(const FLocalPlayerContext& PlayerContext, const int32 InProjectionTargetIndex = INDEX_NONE)
 	{
 		OwningPlayer = PlayerContext;
+		ProjectionTargetIndex = InProjectionTargetIndex;
 		ScreenLayerPtr = nullptr;
 	}
 	
@@ -143,12 +253,13 @@ protected:
 			return ScreenLayer.ToSharedRef();
 		}
 
-		TSharedRef<SMassDrawScreenLayer> NewScreenLayer = SNew(SMassDrawScreenLayer, OwningPlayer);
+		TSharedRef<SMassDrawScreenLayer> NewScreenLayer = SNew(SMassDrawScreenLayer, OwningPlayer, ProjectionTargetIndex);
 		ScreenLayerPtr = NewScreenLayer;
 		return NewScreenLayer;
 	}
 	
 private:
 	FLocalPlayerContext OwningPlayer;
+	int32 ProjectionTargetIndex = INDEX_NONE;
 	TWeakPtr<SMassDrawScreenLayer> ScreenLayerPtr;
 };